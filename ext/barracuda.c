@@ -1,5 +1,10 @@
 #include <ruby.h>
 #include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #ifdef __APPLE__
     #include <OpenCL/opencl.h>
 #else
@@ -13,6 +18,11 @@
 
 static VALUE rb_mBarracuda;
 static VALUE rb_cBuffer;
+static VALUE rb_cImage;
+static VALUE rb_cImage2D;
+static VALUE rb_cImage3D;
+static VALUE rb_cSampler;
+static VALUE rb_cLocal;
 static VALUE rb_cProgram;
 static VALUE rb_eProgramSyntaxError;
 static VALUE rb_eOpenCLError;
@@ -20,11 +30,20 @@ static VALUE rb_cType;
 static VALUE rb_hTypes;
 
 static ID id_times;
+static ID id_local;
 static ID id_to_s;
 static ID id_new;
 static ID id_object;
 static ID id_data_type;
 static ID id_buffer_data;
+static ID id_offset;
+static ID id_count;
+static ID id_order;
+static ID id_type;
+static ID id_normalized;
+static ID id_address;
+static ID id_filter;
+static ID id_normalized_coords;
 
 static ID id_type_bool;
 static ID id_type_char;
@@ -50,6 +69,7 @@ static cl_platform_id platform_id = NULL;
 static cl_device_id device_id = NULL;
 static cl_context context = NULL;
 static size_t max_work_group_size = 65535;
+static cl_ulong local_mem_size = 0;
 static int err;
 
 #define VERSION_STRING "1.3"
@@ -65,16 +85,93 @@ struct buffer {
     size_t member_size;
     long num_items;
     int8_t *cachebuf;
+    int8_t *mapping;
+    size_t mapping_size;
+    int image_dims; /* 0 for linear buffers */
+    size_t region[3];
+    cl_channel_order order;
+    int channels;
+    int normalized;
     cl_mem data;
 };
 
+struct sampler {
+    cl_sampler sampler;
+};
+
+struct image_order {
+    const char *name;
+    cl_channel_order order;
+    int channels;
+};
+
+static struct image_order image_orders[] = {
+    {"r",         CL_R,         1},
+    {"a",         CL_A,         1},
+    {"intensity", CL_INTENSITY, 1},
+    {"luminance", CL_LUMINANCE, 1},
+    {"rg",        CL_RG,        2},
+    {"ra",        CL_RA,        2},
+    {"rgba",      CL_RGBA,      4},
+    {"bgra",      CL_BGRA,      4},
+    {"argb",      CL_ARGB,      4},
+    {NULL,        0,            0}
+};
+
+static int
+vector_type_get(VALUE type, ID *base_type, long *width)
+{
+    const char *name;
+    char base[16];
+    size_t len, n;
+
+    if (TYPE(type) != T_SYMBOL) return 0;
+
+    name = rb_id2name(SYM2ID(type));
+    len = n = strlen(name);
+    while (n > 0 && name[n - 1] >= '0' && name[n - 1] <= '9') n--;
+    if (n == 0 || n == len || n >= sizeof(base)) return 0;
+
+    *width = atol(name + n);
+    if (*width != 2 && *width != 3 && *width != 4 && *width != 8 && *width != 16) {
+        return 0;
+    }
+
+    memcpy(base, name, n);
+    base[n] = '\0';
+    *base_type = rb_intern(base);
+
+    /* double and half have no correct native conversion, so no vectors either */
+    return *base_type == id_type_char  || *base_type == id_type_uchar  ||
+           *base_type == id_type_short || *base_type == id_type_ushort ||
+           *base_type == id_type_int   || *base_type == id_type_uint   ||
+           *base_type == id_type_long  || *base_type == id_type_ulong  ||
+           *base_type == id_type_float;
+}
+
+static long
+data_type_size(VALUE type)
+{
+    VALUE size = rb_hash_aref(rb_hTypes, type);
+    ID base_type;
+    long width;
+
+    if (!NIL_P(size)) return FIX2INT(size);
+    if (vector_type_get(type, &base_type, &width)) {
+        /* 3-component vectors take up the space of 4 components */
+        size = rb_hash_aref(rb_hTypes, ID2SYM(base_type));
+        return FIX2INT(size) * (width == 3 ? 4 : width);
+    }
+    return 0;
+}
+
 static VALUE
 data_type_set(VALUE self, VALUE value)
 {
     if (TYPE(value) != T_SYMBOL) {
         value = rb_str_intern(rb_String(value));
     }
-    if (rb_hash_aref(rb_hTypes, value) == Qnil) {
+    if (data_type_size(value) == 0) {
         rb_raise(rb_eArgError, "invalid data type %s",
             RSTRING_PTR(rb_inspect(value)));
     }
@@ -138,6 +235,10 @@ array_data_type_get(VALUE self)
     struct program *program; \
     Data_Get_Struct(self, struct program, program);
 
+#define GET_SAMPLER() \
+    struct sampler *sampler; \
+    Data_Get_Struct(self, struct sampler, sampler);
+
 #define GET_BUFFER() \
     struct buffer *buffer; \
     Data_Get_Struct(rb_ivar_get(self, id_buffer_data), struct buffer, buffer);
@@ -186,6 +287,7 @@ type_to_native(VALUE value, ID data_type, void *native_value)
         if (TYPE(value) == T_FIXNUM) {
             value = rb_funcall(value, rb_intern("chr"), 0);
         }
+        StringValue(value);
         *((cl_char *)native_value) = RSTRING_PTR(value)[0];
         return;
     }
@@ -240,6 +342,20 @@ type_to_ruby(void *native_value, ID data_type)
     return Qnil;
 }
 
+static void
+vector_to_native(VALUE value, ID base_type, long width, void *native_value)
+{
+    long i, member_size = FIX2INT(rb_hash_aref(rb_hTypes, ID2SYM(base_type)));
+    cl_ulong data_ptr[1];
+
+    for (i = 0; i < width; i++) {
+        /* a single value is replicated across all components */
+        VALUE item = TYPE(value) == T_ARRAY ? RARRAY_PTR(value)[i] : value;
+        type_to_native(item, base_type, data_ptr);
+        memcpy((int8_t *)native_value + i * member_size, data_ptr, member_size);
+    }
+}
+
 static VALUE
 type_initialize(VALUE self, VALUE object)
 {
@@ -284,7 +400,12 @@ static void
 free_buffer_data(struct buffer *buffer)
 {
     clReleaseMemObject(buffer->data);
-    ruby_xfree(buffer->cachebuf);
+    if (buffer->mapping) {
+        munmap(buffer->mapping, buffer->mapping_size);
+    }
+    else {
+        ruby_xfree(buffer->cachebuf);
+    }
 }
 
 static VALUE
@@ -309,6 +430,7 @@ buffer_dirty(VALUE self)
     if (buffer->dirty == Qtrue) return Qtrue;
     if (buffer->data == NULL) return Qtrue;
     if (buffer->cachebuf == NULL) return Qtrue;
+    if (buffer->mapping) return Qfalse;
     if (RARRAY_LEN(self) != buffer->num_items) return Qtrue;
     if (SYM2ID(rb_funcall(self, id_data_type, 0)) != buffer->type) return Qtrue;
     return Qfalse;
@@ -321,12 +443,74 @@ buffer_mark_dirty(VALUE self)
     return (buffer->dirty = Qtrue);
 }
 
+static cl_channel_type
+image_channel_type(ID type, int normalized)
+{
+    /* half is not supported, it has no float16 conversion */
+    if (id_type_float == type)  return CL_FLOAT;
+    if (id_type_char == type)   return normalized ? CL_SNORM_INT8 : CL_SIGNED_INT8;
+    if (id_type_uchar == type)  return normalized ? CL_UNORM_INT8 : CL_UNSIGNED_INT8;
+    if (id_type_short == type)  return normalized ? CL_SNORM_INT16 : CL_SIGNED_INT16;
+    if (id_type_ushort == type) return normalized ? CL_UNORM_INT16 : CL_UNSIGNED_INT16;
+    if (id_type_int == type)    return CL_SIGNED_INT32;
+    if (id_type_uint == type)   return CL_UNSIGNED_INT32;
+    return 0;
+}
+
+static cl_mem
+image_create(struct buffer *buffer)
+{
+    cl_mem image;
+    cl_image_format format;
+
+    format.image_channel_order = buffer->order;
+    format.image_channel_data_type = image_channel_type(buffer->type, buffer->normalized);
+    if (format.image_channel_data_type == 0) {
+        rb_raise(rb_eTypeError, "invalid image channel type %s", rb_id2name(buffer->type));
+    }
+
+#ifdef CL_VERSION_1_2
+    {
+        cl_image_desc desc;
+        MEMZERO(&desc, cl_image_desc, 1);
+        desc.image_type = buffer->image_dims == 3 ?
+            CL_MEM_OBJECT_IMAGE3D : CL_MEM_OBJECT_IMAGE2D;
+        desc.image_width = buffer->region[0];
+        desc.image_height = buffer->region[1];
+        desc.image_depth = buffer->region[2];
+        image = clCreateImage(context, CL_MEM_READ_WRITE, &format, &desc, NULL, &err);
+    }
+#else
+    if (buffer->image_dims == 3) {
+        image = clCreateImage3D(context, CL_MEM_READ_WRITE, &format, buffer->region[0],
+            buffer->region[1], buffer->region[2], 0, 0, NULL, &err);
+    }
+    else {
+        image = clCreateImage2D(context, CL_MEM_READ_WRITE, &format,
+            buffer->region[0], buffer->region[1], 0, NULL, &err);
+    }
+#endif
+
+    if (!image || err != CL_SUCCESS) {
+        rb_raise(rb_eOpenCLError, "failed to create image: %d", err);
+    }
+
+    return image;
+}
+
 static void
 buffer_size_changed(struct buffer *buffer)
 {
     clReleaseMemObject(buffer->data);
-    buffer->data = clCreateBuffer(context, CL_MEM_READ_WRITE,
-            buffer->num_items * buffer->member_size, NULL, NULL);
+    if (buffer->image_dims) {
+        buffer->data = NULL;
+        buffer->data = image_create(buffer);
+    }
+    else {
+        buffer->data = clCreateBuffer(context, CL_MEM_READ_WRITE,
+                buffer->num_items * buffer->member_size, NULL, NULL);
+    }
+    if (buffer->mapping) return; /* cachebuf points into the mapping */
     ruby_xfree(buffer->cachebuf);
     buffer->cachebuf = ruby_xmalloc(buffer->num_items * buffer->member_size);
 }
@@ -336,12 +520,33 @@ buffer_update_cache(VALUE self)
 {
     GET_BUFFER();
 
+    if (buffer->mapping) {
+        if (buffer->data == NULL) buffer_size_changed(buffer);
+        buffer->dirty = Qfalse;
+        return Qnil;
+    }
+
     if (buffer_dirty(self) == Qtrue) {
         long old_num_items = buffer->num_items;
+        ID old_type = buffer->type;
+        VALUE member_size;
         buffer->num_items = RARRAY_LEN(self);
         buffer->type = SYM2ID(rb_funcall(self, id_data_type, 0));
-        buffer->member_size = FIX2INT(rb_hash_aref(rb_hTypes, ID2SYM(buffer->type)));
-        if (buffer->num_items != old_num_items) buffer_size_changed(buffer);
+        member_size = rb_hash_aref(rb_hTypes, ID2SYM(buffer->type));
+        if (NIL_P(member_size)) { /* vector types are only valid as scalars */
+            rb_raise(rb_eTypeError, "invalid buffer data type %s", rb_id2name(buffer->type));
+        }
+        buffer->member_size = FIX2INT(member_size);
+        if (buffer->image_dims && (size_t) buffer->num_items !=
+                buffer->region[0] * buffer->region[1] * buffer->region[2] * buffer->channels) {
+            rb_raise(rb_eArgError, "image data has %ld items, expected %ld",
+                buffer->num_items, (long) (buffer->region[0] * buffer->region[1] *
+                buffer->region[2] * buffer->channels));
+        }
+        if (buffer->num_items != old_num_items || buffer->type != old_type ||
+                buffer->data == NULL) {
+            buffer_size_changed(buffer);
+        }
         buffer->dirty = Qfalse;
         return Qtrue;
     }
@@ -370,15 +575,22 @@ buffer_write(VALUE self, cl_command_queue queue)
 
     GET_BUFFER();
 
-    if (NIL_P(RARRAY_PTR(self)[0])) return Qnil;
+    if (buffer->mapping == NULL) { /* mapped data is already native */
+        if (NIL_P(RARRAY_PTR(self)[0])) return Qnil;
 
-    for (i = 0, index = 0; i < buffer->num_items; i++, index += buffer->member_size) {
-        VALUE item = RARRAY_PTR(self)[i];
-        type_to_native(item, buffer->type, data_ptr);
-        memcpy(buffer->cachebuf + index, data_ptr, buffer->member_size);
+        for (i = 0, index = 0; i < buffer->num_items; i++, index += buffer->member_size) {
+            VALUE item = RARRAY_PTR(self)[i];
+            type_to_native(item, buffer->type, data_ptr);
+            memcpy(buffer->cachebuf + index, data_ptr, buffer->member_size);
+        }
     }
 
-    if (queue != NULL) {
+    if (queue != NULL && buffer->image_dims) {
+        size_t origin[3] = {0, 0, 0};
+        clEnqueueWriteImage(queue, buffer->data, CL_TRUE, origin, buffer->region,
+            0, 0, buffer->cachebuf, 0, NULL, NULL);
+    }
+    else if (queue != NULL) {
         clEnqueueWriteBuffer(queue, buffer->data, CL_TRUE, 0,
             buffer->num_items * buffer->member_size, buffer->cachebuf, 0, NULL, NULL);
     }
@@ -395,11 +607,18 @@ buffer_read(VALUE self, cl_command_queue queue)
 
     if (buffer->outvar != Qtrue) return Qnil;
 
-    if (queue != NULL) {
+    if (queue != NULL && buffer->image_dims) {
+        size_t origin[3] = {0, 0, 0};
+        clEnqueueReadImage(queue, buffer->data, CL_TRUE, origin, buffer->region,
+            0, 0, buffer->cachebuf, 0, NULL, NULL);
+    }
+    else if (queue != NULL) {
         clEnqueueReadBuffer(queue, buffer->data, CL_TRUE, 0,
             buffer->num_items * buffer->member_size, buffer->cachebuf, 0, NULL, NULL);
     }
 
+    if (buffer->mapping) return self; /* leave results native */
+
     for (i = 0, index = 0; i < buffer->num_items; i++, index += buffer->member_size) {
         VALUE value = type_to_ruby(buffer->cachebuf + index, buffer->type);
         rb_ary_store(self, i, value);
@@ -408,6 +627,47 @@ buffer_read(VALUE self, cl_command_queue queue)
     return self;
 }
 
+struct buffer_upload {
+    VALUE buffer;
+    cl_command_queue queue;
+};
+
+static VALUE
+buffer_upload(VALUE arg)
+{
+    struct buffer_upload *upload = (struct buffer_upload *) arg;
+    buffer_update_cache(upload->buffer);
+    return buffer_write(upload->buffer, upload->queue);
+}
+
+struct scalar_conversion {
+    VALUE item;
+    VALUE data_type;
+    void *native_value;
+};
+
+static VALUE
+scalar_to_native(VALUE arg)
+{
+    struct scalar_conversion *conversion = (struct scalar_conversion *) arg;
+    VALUE item = conversion->item;
+    ID base_type;
+    long width;
+
+    if (vector_type_get(conversion->data_type, &base_type, &width)) {
+        if (TYPE(item) == T_ARRAY && RARRAY_LEN(item) != width) {
+            rb_raise(rb_eArgError, "expected %ld vector components, got %s",
+                width, RSTRING_PTR(rb_inspect(item)));
+        }
+        vector_to_native(item, base_type, width, conversion->native_value);
+    }
+    else {
+        type_to_native(item, SYM2ID(conversion->data_type), conversion->native_value);
+    }
+
+    return Qnil;
+}
+
 static VALUE
 array_to_outvar(VALUE self)
 {
@@ -445,6 +705,350 @@ buffer_initialize(int argc, VALUE *argv, VALUE self)
     return self;
 }
 
+static VALUE
+buffer_s_from_file(int argc, VALUE *argv, VALUE klass)
+{
+    VALUE self, path, type, opts, value;
+    long offset = 0, count = -1, page_offset;
+    size_t member_size;
+    struct buffer *buffer;
+    struct stat st;
+    void *map;
+    int fd;
+
+    rb_scan_args(argc, argv, "21", &path, &type, &opts);
+
+    self = rb_funcall(klass, id_new, 0);
+    data_type_set(self, type);
+    type = rb_ivar_get(self, id_data_type);
+    member_size = data_type_size(type);
+
+    if (!NIL_P(opts)) {
+        Check_Type(opts, T_HASH);
+        value = rb_hash_aref(opts, ID2SYM(id_offset));
+        if (!NIL_P(value)) offset = NUM2LONG(value);
+        value = rb_hash_aref(opts, ID2SYM(id_count));
+        if (!NIL_P(value)) count = NUM2LONG(value);
+    }
+
+    fd = open(StringValueCStr(path), O_RDONLY);
+    if (fd < 0) rb_sys_fail(RSTRING_PTR(path));
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        rb_sys_fail(RSTRING_PTR(path));
+    }
+
+    if (offset >= 0 && offset <= (long) st.st_size && count < 0) {
+        count = ((long) st.st_size - offset) / (long) member_size;
+    }
+    if (offset < 0 || offset > (long) st.st_size || count <= 0 ||
+            count > ((long) st.st_size - offset) / (long) member_size) {
+        close(fd);
+        rb_raise(rb_eArgError, "cannot map %ld %s items at offset %ld from %s",
+            count, rb_id2name(SYM2ID(type)), offset, RSTRING_PTR(path));
+    }
+
+    /* mmap offsets must be page aligned */
+    page_offset = offset % sysconf(_SC_PAGESIZE);
+    map = mmap(NULL, page_offset + count * member_size, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE, fd, offset - page_offset);
+    close(fd);
+    if (map == MAP_FAILED) rb_sys_fail(RSTRING_PTR(path));
+
+    Data_Get_Struct(rb_ivar_get(self, id_buffer_data), struct buffer, buffer);
+    buffer->mapping = map;
+    buffer->mapping_size = page_offset + count * member_size;
+    buffer->cachebuf = buffer->mapping + page_offset;
+    buffer->num_items = count;
+    buffer->member_size = member_size;
+    buffer->type = SYM2ID(type);
+
+    return self;
+}
+
+static VALUE
+buffer_is_mapped(VALUE self)
+{
+    GET_BUFFER();
+    return buffer->mapping ? Qtrue : Qfalse;
+}
+
+static VALUE
+buffer_write_to(VALUE self, VALUE path)
+{
+    VALUE tmp_path;
+    FILE *file;
+    mode_t mask;
+    int fd, failed, saved_errno;
+    GET_BUFFER();
+
+    buffer_update_cache(self);
+    if (buffer->mapping == NULL && NIL_P(buffer_write(self, NULL))) {
+        rb_raise(rb_eArgError, "buffer has no data to write");
+    }
+
+    /* write to a temporary file first, the target may be our own mapping */
+    StringValueCStr(path);
+    tmp_path = rb_str_dup(path);
+    rb_str_cat2(tmp_path, ".XXXXXX");
+    fd = mkstemp(RSTRING_PTR(tmp_path));
+    if (fd < 0) rb_sys_fail(RSTRING_PTR(path));
+
+    mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
+
+    file = fdopen(fd, "wb");
+    if (file == NULL) {
+        saved_errno = errno;
+        close(fd);
+        unlink(RSTRING_PTR(tmp_path));
+        errno = saved_errno;
+        rb_sys_fail(RSTRING_PTR(path));
+    }
+
+    errno = 0;
+    failed = fwrite(buffer->cachebuf, buffer->member_size,
+        buffer->num_items, file) != (size_t) buffer->num_items;
+    if (fclose(file) != 0) failed = 1;
+    if (!failed && rename(RSTRING_PTR(tmp_path), RSTRING_PTR(path)) != 0) failed = 1;
+
+    if (failed) {
+        saved_errno = errno;
+        unlink(RSTRING_PTR(tmp_path));
+        if (saved_errno == 0) {
+            rb_raise(rb_eIOError, "failed to write buffer to %s", RSTRING_PTR(path));
+        }
+        errno = saved_errno;
+        rb_sys_fail(RSTRING_PTR(path));
+    }
+
+    return self;
+}
+
+static struct image_order *
+image_order_get(VALUE name)
+{
+    struct image_order *order;
+
+    name = rb_String(name);
+    for (order = image_orders; order->name != NULL; order++) {
+        if (strcmp(order->name, RSTRING_PTR(name)) == 0) return order;
+    }
+
+    rb_raise(rb_eArgError, "invalid channel order %s", RSTRING_PTR(name));
+    return NULL;
+}
+
+static VALUE
+image_initialize(int dims, int argc, VALUE *argv, VALUE self)
+{
+    VALUE data = Qnil, opts = Qnil, type = Qnil, normalized = Qnil, order = Qnil;
+    struct image_order *image_order;
+    struct buffer *buffer;
+    size_t region[3] = {1, 1, 1};
+    long num_items;
+    int i;
+
+    if (argc > dims && TYPE(argv[argc - 1]) == T_HASH) opts = argv[--argc];
+    if (argc == dims + 1) data = argv[--argc];
+    if (argc != dims) {
+        rb_raise(rb_eArgError, "wrong number of arguments (%d for %d)", argc, dims);
+    }
+
+    if (!NIL_P(opts)) {
+        order = rb_hash_aref(opts, ID2SYM(id_order));
+        type = rb_hash_aref(opts, ID2SYM(id_type));
+        normalized = rb_hash_aref(opts, ID2SYM(id_normalized));
+    }
+    image_order = image_order_get(NIL_P(order) ? rb_str_new2("rgba") : order);
+
+    for (i = 0; i < dims; i++) {
+        region[i] = NUM2ULONG(argv[i]);
+        if (region[i] == 0) {
+            rb_raise(rb_eArgError, "image dimensions must be greater than 0");
+        }
+    }
+    num_items = (long) (region[0] * region[1] * region[2]) * image_order->channels;
+
+    if (NIL_P(data)) { /* outvar */
+        data = LONG2NUM(num_items);
+        if (NIL_P(type)) type = ID2SYM(id_type_float);
+    }
+    else {
+        Check_Type(data, T_ARRAY);
+        if (RARRAY_LEN(data) != num_items) {
+            rb_raise(rb_eArgError, "image data has %ld items, expected %ld",
+                RARRAY_LEN(data), num_items);
+        }
+    }
+
+    rb_call_super(1, &data);
+    if (!NIL_P(type)) data_type_set(self, type);
+
+    type = rb_funcall(self, id_data_type, 0);
+    if (image_channel_type(SYM2ID(type), RTEST(normalized)) == 0) {
+        rb_raise(rb_eTypeError, "invalid image channel type %s",
+            RSTRING_PTR(rb_inspect(type)));
+    }
+
+    Data_Get_Struct(rb_ivar_get(self, id_buffer_data), struct buffer, buffer);
+    buffer->image_dims = dims;
+    buffer->region[0] = region[0];
+    buffer->region[1] = region[1];
+    buffer->region[2] = region[2];
+    buffer->order = image_order->order;
+    buffer->channels = image_order->channels;
+    buffer->normalized = RTEST(normalized);
+
+    return self;
+}
+
+static VALUE
+image_abstract_initialize(int argc, VALUE *argv, VALUE self)
+{
+    if (CLASS_OF(self) == rb_cImage) {
+        rb_raise(rb_eNotImpError, "use Barracuda::Image2D or Barracuda::Image3D");
+    }
+    return rb_call_super(argc, argv);
+}
+
+static VALUE
+image2d_initialize(int argc, VALUE *argv, VALUE self)
+{
+    return image_initialize(2, argc, argv, self);
+}
+
+static VALUE
+image3d_initialize(int argc, VALUE *argv, VALUE self)
+{
+    return image_initialize(3, argc, argv, self);
+}
+
+static VALUE
+image_width(VALUE self)
+{
+    GET_BUFFER();
+    return ULONG2NUM(buffer->region[0]);
+}
+
+static VALUE
+image_height(VALUE self)
+{
+    GET_BUFFER();
+    return ULONG2NUM(buffer->region[1]);
+}
+
+static VALUE
+image_depth(VALUE self)
+{
+    GET_BUFFER();
+    return ULONG2NUM(buffer->region[2]);
+}
+
+static void
+free_sampler(struct sampler *sampler)
+{
+    if (sampler->sampler) clReleaseSampler(sampler->sampler);
+    xfree(sampler);
+}
+
+static VALUE
+sampler_s_allocate(VALUE klass)
+{
+    struct sampler *sampler;
+    sampler = ALLOC(struct sampler);
+    MEMZERO(sampler, struct sampler, 1);
+    return Data_Wrap_Struct(klass, 0, free_sampler, sampler);
+}
+
+static VALUE
+sampler_initialize(int argc, VALUE *argv, VALUE self)
+{
+    VALUE opts, value;
+    cl_addressing_mode address = CL_ADDRESS_CLAMP;
+    cl_filter_mode filter = CL_FILTER_NEAREST;
+    cl_bool normalized_coords = CL_FALSE;
+    GET_SAMPLER();
+
+    rb_scan_args(argc, argv, "01", &opts);
+    if (!NIL_P(opts)) {
+        Check_Type(opts, T_HASH);
+
+        value = rb_hash_aref(opts, ID2SYM(id_address));
+        if (!NIL_P(value)) {
+            ID mode = rb_to_id(value);
+            if (mode == rb_intern("none")) address = CL_ADDRESS_NONE;
+            else if (mode == rb_intern("clamp")) address = CL_ADDRESS_CLAMP;
+            else if (mode == rb_intern("clamp_to_edge")) address = CL_ADDRESS_CLAMP_TO_EDGE;
+            else if (mode == rb_intern("repeat")) address = CL_ADDRESS_REPEAT;
+            else if (mode == rb_intern("mirrored_repeat")) address = CL_ADDRESS_MIRRORED_REPEAT;
+            else {
+                rb_raise(rb_eArgError, "invalid address mode %s",
+                    RSTRING_PTR(rb_inspect(value)));
+            }
+        }
+
+        value = rb_hash_aref(opts, ID2SYM(id_filter));
+        if (!NIL_P(value)) {
+            ID mode = rb_to_id(value);
+            if (mode == rb_intern("nearest")) filter = CL_FILTER_NEAREST;
+            else if (mode == rb_intern("linear")) filter = CL_FILTER_LINEAR;
+            else {
+                rb_raise(rb_eArgError, "invalid filter mode %s",
+                    RSTRING_PTR(rb_inspect(value)));
+            }
+        }
+
+        if (RTEST(rb_hash_aref(opts, ID2SYM(id_normalized_coords)))) {
+            normalized_coords = CL_TRUE;
+        }
+    }
+
+    if (sampler->sampler) {
+        clReleaseSampler(sampler->sampler);
+        sampler->sampler = 0;
+    }
+
+    sampler->sampler = clCreateSampler(context, normalized_coords, address, filter, &err);
+    if (!sampler->sampler || err != CL_SUCCESS) {
+        sampler->sampler = 0;
+        rb_raise(rb_eOpenCLError, "failed to create sampler: %d", err);
+    }
+
+    return self;
+}
+
+static VALUE
+local_size(VALUE self)
+{
+    VALUE type = rb_ivar_get(self, id_data_type);
+    return ULONG2NUM(data_type_size(type) * NUM2ULONG(rb_ivar_get(self, id_count)));
+}
+
+static VALUE
+local_count(VALUE self)
+{
+    return rb_ivar_get(self, id_count);
+}
+
+static VALUE
+local_initialize(VALUE self, VALUE type, VALUE count)
+{
+    data_type_set(self, type);
+    if (NUM2LONG(count) <= 0) {
+        rb_raise(rb_eArgError, "local memory count must be greater than 0");
+    }
+    rb_ivar_set(self, id_count, count);
+
+    if (NUM2ULL(local_size(self)) > local_mem_size) {
+        rb_raise(rb_eArgError, "local memory size %lu exceeds device limit of %lu bytes",
+            NUM2ULONG(local_size(self)), (unsigned long) local_mem_size);
+    }
+
+    return self;
+}
+
 static void
 free_program(struct program *program)
 {
@@ -512,11 +1116,15 @@ program_compile(VALUE self, VALUE source)
 static VALUE
 program_method_missing(int argc, VALUE *argv, VALUE self)
 {
-    int i;
+    int i, state;
     size_t global[3] = {1, 1, 1}, local[3] = {0, 1, 1}, tmp;
+    size_t image_size[3] = {0, 1, 1}, buffer_size = 1;
+    cl_ulong local_total = 0;
+    ID base_type;
+    long width;
     cl_kernel kernel;
     cl_command_queue commands;
-    VALUE result;
+    VALUE result, times = Qnil;
     GET_PROGRAM();
 
     argv[0] = rb_funcall(argv[0], id_to_s, 0);
@@ -537,37 +1145,69 @@ program_method_missing(int argc, VALUE *argv, VALUE self)
 
         if (i == argc - 1 && TYPE(item) == T_HASH) {
             VALUE worker_size = rb_hash_aref(item, ID2SYM(id_times));
-            if (RTEST(worker_size) && TYPE(worker_size) == T_FIXNUM) {
-                global[0] = FIX2UINT(worker_size);
-            }
-            else {
+            VALUE group_size = rb_hash_aref(item, ID2SYM(id_local));
+            if ((NIL_P(worker_size) && NIL_P(group_size)) ||
+                    (!NIL_P(worker_size) && TYPE(worker_size) != T_FIXNUM) ||
+                    (!NIL_P(group_size) && TYPE(group_size) != T_FIXNUM)) {
                 CLEAN();
-                rb_raise(rb_eArgError, "opts hash must be {:times => INT_VALUE}, got %s",
+                rb_raise(rb_eArgError, "opts hash must be {:times => INT_VALUE, :local => INT_VALUE}, got %s",
                     RSTRING_PTR(rb_inspect(item)));
             }
+            times = worker_size;
+            if (!NIL_P(group_size)) local[0] = FIX2UINT(group_size);
             break;
         }
 
-        if (CLASS_OF(item) == rb_cArray) {
+        if (CLASS_OF(item) == rb_cArray &&
+                !vector_type_get(rb_ivar_get(item, id_data_type), &base_type, &width)) {
             /* create buffer from arg */
             argv[i] = item = rb_funcall(rb_cBuffer, id_new, 1, item);
         }
 
-        if (CLASS_OF(item) == rb_cBuffer) {
+        if (rb_obj_is_kind_of(item, rb_cBuffer)) {
             struct buffer *buffer;
+            struct buffer_upload upload;
             Data_Get_Struct(rb_ivar_get(item, id_buffer_data), struct buffer, buffer);
 
-            buffer_update_cache(item);
-            buffer_write(item, commands);
+            upload.buffer = item;
+            upload.queue = commands;
+            rb_protect(buffer_upload, (VALUE) &upload, &state);
+            if (state) {
+                CLEAN();
+                rb_jump_tag(state);
+            }
+
             err = clSetKernelArg(kernel, i - 1, sizeof(cl_mem), &buffer->data);
-            if (RARRAY_LEN(item) > (long) global[0]) {
-                global[0] = RARRAY_LEN(item);
+            if (buffer->image_dims) {
+                int j;
+                for (j = 0; j < 3; j++) {
+                    if (buffer->region[j] > image_size[j]) image_size[j] = buffer->region[j];
+                }
+            }
+            else if (buffer->num_items > (long) buffer_size) {
+                buffer_size = buffer->num_items;
+            }
+        }
+        else if (rb_obj_is_kind_of(item, rb_cSampler)) {
+            struct sampler *sampler;
+            Data_Get_Struct(item, struct sampler, sampler);
+            err = clSetKernelArg(kernel, i - 1, sizeof(cl_sampler), &sampler->sampler);
+        }
+        else if (rb_obj_is_kind_of(item, rb_cLocal)) {
+            size_t size = NUM2ULONG(local_size(item));
+            local_total += size;
+            if (local_total > local_mem_size) {
+                CLEAN();
+                rb_raise(rb_eArgError, "local memory arguments exceed device limit of %lu bytes",
+                    (unsigned long) local_mem_size);
             }
+            err = clSetKernelArg(kernel, i - 1, size, NULL);
         }
         else {
-            unsigned long data_ptr[16]; /* a buffer of data */
+            cl_ulong data_ptr[16]; /* a buffer of data, large enough for a long16 */
             size_t data_size_t;
-            VALUE data_type, data_size;
+            struct scalar_conversion conversion;
+            VALUE data_type;
 
             if (CLASS_OF(item) == rb_cType) {
                 data_type = rb_funcall(item, id_data_type, 0);
@@ -576,15 +1216,22 @@ program_method_missing(int argc, VALUE *argv, VALUE self)
             else {
                 data_type = rb_funcall(item, id_data_type, 0);
             }
-            data_size = rb_hash_aref(rb_hTypes, data_type);
-            if (NIL_P(data_size)) {
+            data_size_t = data_type_size(data_type);
+            if (data_size_t == 0) {
                 CLEAN();
                 rb_raise(rb_eTypeError, "invalid data type for %s",
                     RSTRING_PTR(rb_inspect(item)));
             }
 
-            data_size_t = FIX2UINT(data_size);
-            type_to_native(item, SYM2ID(data_type), (void *)data_ptr);
+            conversion.item = item;
+            conversion.data_type = data_type;
+            conversion.native_value = data_ptr;
+            rb_protect(scalar_to_native, (VALUE) &conversion, &state);
+            if (state) {
+                CLEAN();
+                rb_jump_tag(state);
+            }
+
             err = clSetKernelArg(kernel, i - 1, data_size_t, data_ptr);
         }
 
@@ -594,7 +1241,23 @@ program_method_missing(int argc, VALUE *argv, VALUE self)
         }
     }
 
+    if (image_size[0] > 0) { /* images define the grid, buffers are per pixel */
+        global[0] = image_size[0];
+        global[1] = image_size[1];
+        global[2] = image_size[2];
+    }
+    else {
+        global[0] = buffer_size;
+    }
+    if (!NIL_P(times)) global[0] = FIX2UINT(times);
+
     err = clGetKernelWorkGroupInfo(kernel, device_id, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &tmp, NULL);
+    if (err != CL_SUCCESS) tmp = max_work_group_size;
+    if (local[0] > 0 && (local[0] > tmp || global[0] % local[0] != 0)) {
+        CLEAN();
+        rb_raise(rb_eArgError, "local work size %lu must divide the work size %lu and be at most %lu",
+            (unsigned long) local[0], (unsigned long) global[0], (unsigned long) tmp);
+    }
     err = clEnqueueNDRangeKernel(commands, kernel, 3, NULL, global, local[0] == 0 ? NULL : local, 0, NULL, NULL);
     if (err != CL_SUCCESS) {
         CLEAN();
@@ -612,7 +1275,7 @@ program_method_missing(int argc, VALUE *argv, VALUE self)
 
     for (i = 1; i < argc; i++) {
         VALUE item = argv[i];
-        if (CLASS_OF(item) == rb_cBuffer) {
+        if (rb_obj_is_kind_of(item, rb_cBuffer)) {
             if (RTEST(buffer_read(item, commands))) {
                 rb_ary_push(result, item);
             }
@@ -663,16 +1326,28 @@ init_opencl()
     clGetDeviceInfo(device_id, CL_DEVICE_MAX_WORK_GROUP_SIZE,
         sizeof(size_t), &max_work_group_size, NULL);
     max_work_group_size = 4096;
+
+    clGetDeviceInfo(device_id, CL_DEVICE_LOCAL_MEM_SIZE,
+        sizeof(cl_ulong), &local_mem_size, NULL);
 }
 
 void
 Init_barracuda()
 {
     id_times = rb_intern("times");
+    id_local = rb_intern("local");
     id_new = rb_intern("new");
     id_to_s = rb_intern("to_s");
     id_data_type = rb_intern("data_type");
     id_buffer_data = rb_intern("buffer_data");
+    id_offset = rb_intern("offset");
+    id_count = rb_intern("count");
+    id_order = rb_intern("order");
+    id_type = rb_intern("type");
+    id_normalized = rb_intern("normalized");
+    id_address = rb_intern("address");
+    id_filter = rb_intern("filter");
+    id_normalized_coords = rb_intern("normalized_coords");
 
     rb_hTypes = rb_hash_new();
     rb_define_method(rb_mKernel, "Type", type_new, 1);
@@ -692,11 +1367,35 @@ Init_barracuda()
     rb_define_method(rb_cProgram, "method_missing", program_method_missing, -1);
 
     rb_cBuffer = rb_define_class_under(rb_mBarracuda, "Buffer", rb_cArray);
+    rb_define_singleton_method(rb_cBuffer, "from_file", buffer_s_from_file, -1);
     rb_define_method(rb_cBuffer, "initialize", buffer_initialize, -1);
     rb_define_method(rb_cBuffer, "outvar", buffer_outvar, 0);
     rb_define_method(rb_cBuffer, "outvar?", buffer_is_outvar, 0);
     rb_define_method(rb_cBuffer, "mark_dirty", buffer_mark_dirty, 0);
     rb_define_method(rb_cBuffer, "dirty?", buffer_dirty, 0);
+    rb_define_method(rb_cBuffer, "mapped?", buffer_is_mapped, 0);
+    rb_define_method(rb_cBuffer, "write_to", buffer_write_to, 1);
+
+    rb_cImage = rb_define_class_under(rb_mBarracuda, "Image", rb_cBuffer);
+    rb_define_method(rb_cImage, "initialize", image_abstract_initialize, -1);
+    rb_define_method(rb_cImage, "width", image_width, 0);
+    rb_define_method(rb_cImage, "height", image_height, 0);
+    rb_define_method(rb_cImage, "depth", image_depth, 0);
+
+    rb_cImage2D = rb_define_class_under(rb_mBarracuda, "Image2D", rb_cImage);
+    rb_define_method(rb_cImage2D, "initialize", image2d_initialize, -1);
+
+    rb_cImage3D = rb_define_class_under(rb_mBarracuda, "Image3D", rb_cImage);
+    rb_define_method(rb_cImage3D, "initialize", image3d_initialize, -1);
+
+    rb_cSampler = rb_define_class_under(rb_mBarracuda, "Sampler", rb_cObject);
+    rb_define_alloc_func(rb_cSampler, sampler_s_allocate);
+    rb_define_method(rb_cSampler, "initialize", sampler_initialize, -1);
+
+    rb_cLocal = rb_define_class_under(rb_mBarracuda, "Local", rb_cObject);
+    rb_define_method(rb_cLocal, "initialize", local_initialize, 2);
+    rb_define_method(rb_cLocal, "count", local_count, 0);
+    rb_define_method(rb_cLocal, "size", local_size, 0);
 
     rb_cType = rb_define_class_under(rb_mBarracuda, "Type", rb_cObject);
     rb_define_method(rb_cType, "initialize", type_initialize, 1);
@@ -713,4 +1412,5 @@ Init_barracuda()
     rb_define_method(rb_cFloat, "data_type", float_data_type_get, 0);
 
     init_opencl();
+    rb_define_const(rb_cLocal, "MAX_SIZE", ULL2NUM(local_mem_size));
 }
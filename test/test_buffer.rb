@@ -1,6 +1,7 @@
 $:.unshift(File.dirname(__FILE__) + '/../ext/')
 
 require "test/unit"
+require "tempfile"
 require "barracuda"
 
 include Barracuda
@@ -35,4 +36,51 @@ class TestBuffer < Test::Unit::TestCase
     b = Buffer.new(8)
     assert b.outvar?
   end
+  
+  def test_buffer_from_file
+    file = Tempfile.new('barracuda')
+    file.binmode
+    file.write [1.5, 2.5, 3.5, 4.5].pack('f*')
+    file.close
+    
+    b = Buffer.from_file(file.path, :float, :offset => 4, :count => 2)
+    assert b.mapped?
+    assert_equal :float, b.data_type
+    b.write_to(file.path + '.out')
+    assert_equal [2.5, 3.5], File.binread(file.path + '.out').unpack('f*')
+  ensure
+    File.unlink(file.path + '.out') rescue nil
+    file.unlink
+  end
+  
+  def test_buffer_write_to_mapped_file
+    file = Tempfile.new('barracuda')
+    file.binmode
+    file.write((1..100).map {|x| x.to_f }.pack('f*'))
+    file.close
+    
+    Buffer.from_file(file.path, :float).write_to(file.path)
+    assert_equal (1..100).map {|x| x.to_f }, File.binread(file.path).unpack('f*')
+  ensure
+    file.unlink
+  end
+  
+  def test_buffer_from_file_out_of_range
+    file = Tempfile.new('barracuda')
+    file.write [1, 2].pack('l*')
+    file.close
+    assert_raise(ArgumentError) { Buffer.from_file(file.path, :int, :count => 3) }
+    assert_raise(ArgumentError) { Buffer.from_file(file.path, :int, :offset => 12) }
+  ensure
+    file.unlink
+  end
+  
+  def test_buffer_write_to
+    file = Tempfile.new('barracuda')
+    file.close
+    Buffer.new([1, 2, 3]).to_type(:short).write_to(file.path)
+    assert_equal [1, 2, 3], File.binread(file.path).unpack('s*')
+  ensure
+    file.unlink
+  end
 end
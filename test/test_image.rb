@@ -0,0 +1,61 @@
+$:.unshift(File.dirname(__FILE__) + '/../ext/')
+
+require "test/unit"
+require "barracuda"
+
+include Barracuda
+
+class TestImage < Test::Unit::TestCase
+  def test_image2d_create_with_size
+    i = Image2D.new(4, 2)
+    assert_kind_of Buffer, i
+    assert_equal 32, i.size
+    assert_equal [4, 2, 1], [i.width, i.height, i.depth]
+    assert_equal :float, i.data_type
+    assert i.outvar?
+  end
+  
+  def test_image2d_create_with_data
+    i = Image2D.new(2, 2, [1, 2, 3, 4], :order => :r, :type => :uchar)
+    assert_equal [1, 2, 3, 4], i
+    assert_equal :uchar, i.data_type
+    assert !i.outvar?
+  end
+  
+  def test_image3d_create
+    i = Image3D.new(2, 3, 4, :order => :rg)
+    assert_equal 48, i.size
+    assert_equal [2, 3, 4], [i.width, i.height, i.depth]
+  end
+  
+  def test_image_invalid_data_size
+    assert_raise(ArgumentError) { Image2D.new(2, 2, [1, 2, 3], :order => :r) }
+  end
+  
+  def test_image_invalid_args
+    assert_raise(ArgumentError) { Image2D.new(2) }
+    assert_raise(ArgumentError) { Image2D.new(0, 2) }
+    assert_raise(ArgumentError) { Image2D.new(2, 2, :order => :xyz) }
+  end
+  
+  def test_image_invalid_type
+    assert_raise(TypeError) { Image2D.new(2, 2, :type => :double) }
+    assert_raise(TypeError) { Image2D.new(2, 2, :type => :half) }
+    assert_raise(TypeError) { Image2D.new(2, 2, :type => :long) }
+    assert_raise(TypeError) { Image2D.new(1, 1, [1, 2, 3, 4].to_type(:float4)) }
+  end
+  
+  def test_image_is_abstract
+    assert_raise(NotImplementedError) { Image.new([1.0] * 4) }
+  end
+  
+  def test_sampler_create
+    assert_kind_of Sampler, Sampler.new
+    assert_kind_of Sampler, Sampler.new(:address => :clamp_to_edge, :filter => :linear)
+  end
+  
+  def test_sampler_invalid_options
+    assert_raise(ArgumentError) { Sampler.new(:address => :bogus) }
+    assert_raise(ArgumentError) { Sampler.new(:filter => :bogus) }
+  end
+end
@@ -1,6 +1,7 @@
 $:.unshift(File.dirname(__FILE__) + '/../ext/')
 
 require "test/unit"
+require "tempfile"
 require "barracuda"
 
 # CL - Enable these extensions for atom_add() on various types
@@ -234,6 +235,112 @@ class TestProgram < Test::Unit::TestCase
     assert_equal [6, 7, 8], p.add5(data)
   end
   
+  def test_program_mapped_buffer
+    p = Program.new <<-CL
+      __kernel void add5(__global int *data) {
+        int i = get_global_id(0);
+        data[i] = data[i] + 5;
+      }
+    CL
+    
+    file = Tempfile.new('barracuda')
+    file.write((1..1000).to_a.pack('l*'))
+    file.close
+    
+    data = Buffer.from_file(file.path, :int).outvar
+    assert_same data, p.add5(data)
+    data.write_to(file.path)
+    assert_equal (6..1005).to_a, File.binread(file.path).unpack('l*')
+  ensure
+    file.unlink
+  end
+  
+  def test_program_image2d
+    p = Program.new <<-CL
+      __kernel void shift(__read_only image2d_t in, sampler_t s, __write_only image2d_t out) {
+        int2 pos = (int2)(get_global_id(0), get_global_id(1));
+        write_imagef(out, pos, read_imagef(in, s, pos - (int2)(1, 0)));
+      }
+    CL
+    
+    input = Image2D.new(3, 2, (1..6).map {|x| [x, 0, 0, 0] }.flatten, :type => :float)
+    out = p.shift(input, Sampler.new(:address => :clamp_to_edge), Image2D.new(3, 2))
+    assert_equal [1, 1, 2, 4, 4, 5], (0...6).map {|i| out[i * 4] }
+  end
+  
+  def test_program_local_memory
+    p = Program.new <<-CL
+      __kernel void sum(__global int *out, __global int *in, __local int *scratch) {
+        int i, lid = get_local_id(0);
+        scratch[lid] = in[get_global_id(0)];
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (lid == 0) {
+          int total = 0;
+          for (i = 0; i < get_local_size(0); i++) total += scratch[i];
+          out[get_group_id(0)] = total;
+        }
+      }
+    CL
+    
+    input = (1..64).to_a
+    out = p.sum(Buffer.new(4), input, Local.new(:int, 16), :local => 16)
+    assert_equal input.each_slice(16).map {|s| s.inject(0) {|a, b| a + b } }, out
+  end
+  
+  def test_program_invalid_local
+    p = Program.new("__kernel void sum(__local int *x, __local int *y) { }")
+    half = Local::MAX_SIZE / 2 + 1
+    assert_raise(ArgumentError) { p.sum(Local.new(:char, half), Local.new(:char, half)) }
+    assert_raise(ArgumentError) { p.sum(Local.new(:int, 1), Local.new(:int, 1), :local => 3, :times => 8) }
+    assert_raise(ArgumentError) { p.sum(Local.new(:int, 1), Local.new(:int, 1), :local => "x") }
+  end
+  
+  def test_program_vector_args
+    p = Program.new <<-CL
+      __kernel void vec(__global float4 *out, __global int *iout, float4 v, int2 n) {
+        out[0] = v + (float4)(0.5f);
+        iout[0] = n.x; iout[1] = n.y;
+      }
+    CL
+    
+    out, iout = Buffer.new(4).to_type(:float), Buffer.new(2)
+    p.vec(out, iout, [1, 2, 3, 4].to_type(:float4), 7.to_type(:int2), :times => 1)
+    assert_equal [1.5, 2.5, 3.5, 4.5], out
+    assert_equal [7, 7], iout
+  end
+  
+  def test_program_invalid_vector_arg
+    p = Program.new("__kernel void vec(float4 v) { }")
+    assert_raise(ArgumentError) { p.vec([1, 2].to_type(:float4)) }
+    assert_raise(TypeError) { p.vec(Buffer.new([1, 2, 3, 4]).to_type(:float4)) }
+    assert_raise(TypeError) { p.vec([1.5, 2, 3, 4].to_type(:char4)) }
+    assert_raise(RangeError) { p.vec([2**40, 0, 0, 0].to_type(:uint4)) }
+  end
+  
+  def test_program_local_and_sampler_subclasses
+    local_class, sampler_class = Class.new(Local), Class.new(Sampler)
+    p = Program.new("__kernel void x(__local int *l, sampler_t s) { }")
+    assert_nil p.x(local_class.new(:int, 4), sampler_class.new)
+  end
+  
+  def test_program_opts_ignore_unknown_keys
+    p = Program.new("__kernel void sum(int x) { }")
+    assert_nothing_raised { p.sum(1, :times => 2, :other => true) }
+  end
+  
+  def test_program_image2d_with_buffer
+    p = Program.new <<-CL
+      __kernel void red(__read_only image2d_t in, sampler_t s, __global float *out) {
+        int2 pos = (int2)(get_global_id(0), get_global_id(1));
+        out[pos.y * get_global_size(0) + pos.x] = read_imagef(in, s, pos).x;
+      }
+    CL
+    
+    input = Image2D.new(3, 2, (1..6).map {|x| [x, 0, 0, 0] }.flatten, :type => :float)
+    out = p.red(input, Sampler.new, Buffer.new(6).to_type(:float))
+    assert_equal [1, 2, 3, 4, 5, 6], out
+  end
+  
   def test_program_no_outvars
     p = Program.new("__kernel void x(int x) { }")
     assert_nil p.x(1)
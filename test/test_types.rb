@@ -65,4 +65,26 @@ class TestDataTypes < Test::Unit::TestCase
     assert_equal :long, Type.new(1).long.data_type
     assert_equal :uchar, Type(1).uchar.data_type
   end
+  
+  def test_vector_types
+    assert_equal :float4, [1, 2, 3, 4].to_type(:float4).data_type
+    assert_equal :int8, Type(1).int8.data_type
+    assert_raise(ArgumentError) { 1.to_type(:float5) }
+    assert_raise(ArgumentError) { 1.to_type(:bool4) }
+    assert_raise(ArgumentError) { 1.to_type(:double4) }
+    assert_raise(ArgumentError) { 1.to_type(:half2) }
+  end
+  
+  def test_local_size
+    assert_equal 64, Local.new(:float, 16).size
+    assert_equal 64, Local.new(:float4, 4).size
+    assert_equal 16, Local.new(:float3, 1).size
+    assert_equal :float, Local.new(:float, 1).data_type
+  end
+  
+  def test_invalid_local
+    assert_raise(ArgumentError) { Local.new(:float, 0) }
+    assert_raise(ArgumentError) { Local.new(:unknown, 1) }
+    assert_raise(ArgumentError) { Local.new(:char, Local::MAX_SIZE + 1) }
+  end
 end